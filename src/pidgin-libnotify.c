@@ -32,6 +32,7 @@
 #include <debug.h>
 #include <util.h>
 #include <privacy.h>
+#include <notify.h>
 
 /* for pidgin_create_prpl_icon */
 #include <gtkutils.h>
@@ -39,11 +40,42 @@
 #include <libnotify/notify.h>
 
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #define PLUGIN_ID "pidgin-libnotify"
 
 static GHashTable *buddy_hash;
 
+/* notification history, a fixed-size ring kept in an mmap()ed file so
+ * appends are plain memory writes and nothing is parsed at load */
+#define HISTORY_FILE "libnotify-history"
+#define HISTORY_MAGIC 0x6c6e6831 /* "lnh1" */
+#define HISTORY_SIZE 256
+
+typedef struct {
+	gint64 timestamp;
+	gchar account[64];
+	gchar contact[64];
+	gchar text[128];
+} HistoryEntry;
+
+typedef struct {
+	guint32 magic;
+	guint32 size;
+	guint32 entry_size;
+	guint32 count;			/* total appends, never wraps back */
+	HistoryEntry entries[HISTORY_SIZE];
+} HistoryRing;
+
+static HistoryRing *history = NULL;
+
+/* messages dropped as copies of one already shown */
+static guint dedup_suppressed = 0;
+
 static PurplePluginPrefFrame *
 get_plugin_pref_frame (PurplePlugin *plugin)
 {
@@ -78,6 +110,18 @@ get_plugin_pref_frame (PurplePlugin *plugin)
 	purple_plugin_pref_set_bounds(ppref, 100, 100000);
 	purple_plugin_pref_frame_add (frame, ppref);
 
+	ppref = purple_plugin_pref_new_with_name_and_label (
+                            "/plugins/gtk/libnotify/dedup_window",
+                            _("Merge duplicate messages within (msec, 0 to disable)"));
+	purple_plugin_pref_set_bounds(ppref, 0, 60000);
+	purple_plugin_pref_frame_add (frame, ppref);
+
+	ppref = purple_plugin_pref_new_with_name_and_label (
+                            "/plugins/gtk/libnotify/history_show",
+                            _("Notifications shown in history"));
+	purple_plugin_pref_set_bounds(ppref, 1, HISTORY_SIZE);
+	purple_plugin_pref_frame_add (frame, ppref);
+
 	ppref = purple_plugin_pref_new_with_name_and_label (
                             "/plugins/gtk/libnotify/blocked",
                             _("Ignore events from blocked users"));
@@ -247,31 +291,77 @@ closed_cb (NotifyNotification *notification)
 	return FALSE;
 }
 
-/* you must g_free the returned string
- * num_chars is utf-8 characters */
+/* worst case is every character escaped as a 6 byte entity */
+#define ESCAPED_LEN(num_chars) ((num_chars) * 6 + 1)
+
+/* num_chars is utf-8 characters, buf must hold at least
+ * ESCAPED_LEN(num_chars) bytes; returns buf.
+ * anything after the first invalid utf-8 sequence is dropped */
 static gchar *
 truncate_escape_string (const gchar *str,
-						int num_chars)
+						int num_chars,
+						gchar *buf)
 {
-	gchar *escaped_str;
+	const gchar *p, *end;
+	gchar *out;
+	int limit, i;
 
-	if (g_utf8_strlen (str, num_chars*2+1) > num_chars) {
-		gchar *truncated_str;
-		gchar *str2;
+	g_utf8_validate (str, -1, &end);
 
-		/* allocate number of bytes and not number of utf-8 chars */
-		str2 = g_malloc ((num_chars-1) * 2 * sizeof(gchar));
+	if (g_utf8_strlen (str, MIN (end - str, (num_chars+1)*4)) > num_chars)
+		limit = num_chars - 2;
+	else
+		limit = num_chars;
+
+	out = buf;
+	for (p = str, i = 0; p < end && i < limit; i++) {
+		gunichar c = g_utf8_get_char (p);
+		const gchar *next = g_utf8_next_char (p);
+
+		/* same entities g_markup_escape_text() would produce */
+		switch (c) {
+		case '&':
+			memcpy (out, "&amp;", 5);
+			out += 5;
+			break;
+		case '<':
+			memcpy (out, "&lt;", 4);
+			out += 4;
+			break;
+		case '>':
+			memcpy (out, "&gt;", 4);
+			out += 4;
+			break;
+		case '\'':
+			memcpy (out, "&#39;", 5);
+			out += 5;
+			break;
+		case '"':
+			memcpy (out, "&quot;", 6);
+			out += 6;
+			break;
+		default:
+			if ((c >= 0x1 && c <= 0x8) || c == 0xb || c == 0xc ||
+				(c >= 0xe && c <= 0x1f) || c == 0x7f ||
+				(c >= 0x80 && c <= 0x84) || (c >= 0x86 && c <= 0x9f)) {
+				out += g_snprintf (out, 7, "&#x%x;", c);
+			} else {
+				while (p < next)
+					*out++ = *p++;
+				continue;
+			}
+			break;
+		}
+		p = next;
+	}
 
-		g_utf8_strncpy (str2, str, num_chars-2);
-		truncated_str = g_strdup_printf ("%s..", str2);
-		escaped_str = g_markup_escape_text (truncated_str, strlen (truncated_str));
-		g_free (str2);
-		g_free (truncated_str);
-	} else {
-		escaped_str = g_markup_escape_text (str, strlen (str));
+	if (p < end) {
+		*out++ = '.';
+		*out++ = '.';
 	}
+	*out = '\0';
 
-	return escaped_str;
+	return buf;
 }
 
 static gboolean
@@ -287,7 +377,184 @@ should_notify_unavailable (PurpleAccount *account)
 	return purple_status_is_online (status) && purple_status_is_available (status);
 }
 
+static gboolean
+conv_has_focus (PurpleConversation *conv)
+{
+	return conv && conv->ui_ops && conv->ui_ops->has_focus &&
+		conv->ui_ops->has_focus (conv) == TRUE;
+}
+
+static void
+history_open (void)
+{
+	gchar *filename;
+	int fd, err;
+	HistoryRing *ring;
+
+	filename = g_build_filename (purple_user_dir (), HISTORY_FILE, NULL);
+
+	fd = open (filename, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		purple_debug_error (PLUGIN_ID, "history_open(), couldn't open %s: %s\n",
+						  filename, g_strerror (errno));
+		g_free (filename);
+		return;
+	}
+
+	/* reserve the blocks now: writing to a hole through the mapping on a
+	 * full disk would raise SIGBUS later, so history stays off instead */
+	err = posix_fallocate (fd, 0, sizeof (HistoryRing));
+	if (err != 0) {
+		purple_debug_error (PLUGIN_ID, "history_open(), couldn't allocate %s: %s\n",
+						  filename, g_strerror (err));
+		close (fd);
+		g_free (filename);
+		return;
+	}
+
+	ring = mmap (NULL, sizeof (HistoryRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+
+	if (ring == MAP_FAILED) {
+		purple_debug_error (PLUGIN_ID, "history_open(), couldn't map %s: %s\n",
+						  filename, g_strerror (errno));
+		g_free (filename);
+		return;
+	}
+
+	/* new file, or one written with a different layout */
+	if (ring->magic != HISTORY_MAGIC || ring->size != HISTORY_SIZE ||
+		ring->entry_size != sizeof (HistoryEntry)) {
+		memset (ring, 0, sizeof (HistoryRing));
+		ring->magic = HISTORY_MAGIC;
+		ring->size = HISTORY_SIZE;
+		ring->entry_size = sizeof (HistoryEntry);
+	}
+
+	g_free (filename);
+	history = ring;
+}
+
 static void
+history_close (void)
+{
+	if (!history)
+		return;
+
+	munmap (history, sizeof (HistoryRing));
+	history = NULL;
+}
+
+/* copies at most size-1 bytes without splitting a utf-8 character */
+static void
+history_copy (gchar *dest,
+			  gsize size,
+			  const gchar *src)
+{
+	const gchar *end;
+
+	g_strlcpy (dest, src ? src : "", size);
+	g_utf8_validate (dest, -1, &end);
+	dest[end - dest] = '\0';
+}
+
+static void
+history_append (PurpleAccount *account,
+				const gchar *contact,
+				const gchar *text)
+{
+	HistoryEntry *entry;
+
+	if (!history)
+		return;
+
+	entry = &history->entries[history->count % HISTORY_SIZE];
+	entry->timestamp = time (NULL);
+	history_copy (entry->account, sizeof (entry->account),
+				  purple_account_get_username (account));
+	history_copy (entry->contact, sizeof (entry->contact), contact);
+	history_copy (entry->text, sizeof (entry->text), text);
+	history->count++;
+}
+
+/* the file is shared and may be damaged, so only the valid utf-8
+ * prefix of a field is used; you must g_free the returned string */
+static gchar *
+history_escape (const gchar *field,
+				gsize size)
+{
+	const gchar *end;
+
+	g_utf8_validate (field, strnlen (field, size), &end);
+
+	return g_markup_escape_text (field, end - field);
+}
+
+static void
+history_show_cb (PurplePluginAction *action)
+{
+	GString *str;
+	gchar *secondary;
+	guint32 i, first, shown;
+
+	if (!history || history->count == 0) {
+		purple_notify_info (action->plugin, _("Notification History"),
+						  _("No notifications yet."), NULL);
+		return;
+	}
+
+	shown = purple_prefs_get_int ("/plugins/gtk/libnotify/history_show");
+	shown = CLAMP (shown, 1, MIN (history->count, HISTORY_SIZE));
+	first = history->count - shown;
+
+	str = g_string_new (NULL);
+
+	/* newest first */
+	for (i = history->count; i-- > first;) {
+		HistoryEntry *entry = &history->entries[i % HISTORY_SIZE];
+		time_t t = (time_t)entry->timestamp;
+		struct tm *tm;
+		gchar *account, *contact, *text;
+
+		/* an out of range timestamp means a damaged entry */
+		tm = localtime (&t);
+		if (!tm)
+			continue;
+
+		account = history_escape (entry->account, sizeof (entry->account));
+		contact = history_escape (entry->contact, sizeof (entry->contact));
+		text = history_escape (entry->text, sizeof (entry->text));
+
+		g_string_append_printf (str, "<b>%s</b> %s (%s): %s<br>",
+								purple_date_format_full (tm), contact, account, text);
+
+		g_free (account);
+		g_free (contact);
+		g_free (text);
+	}
+
+	secondary = g_strdup_printf (dngettext (PACKAGE, "%u duplicate message suppressed",
+											"%u duplicate messages suppressed",
+											dedup_suppressed),
+								 dedup_suppressed);
+
+	purple_notify_formatted (action->plugin, _("Notification History"),
+						   _("Recent notifications"), secondary, str->str, NULL, NULL);
+
+	g_free (secondary);
+	g_string_free (str, TRUE);
+}
+
+static GList *
+plugin_actions (PurplePlugin *plugin,
+				gpointer context)
+{
+	return g_list_append (NULL, purple_plugin_action_new (_("Show Notification History"),
+														   history_show_cb));
+}
+
+/* returns TRUE if a notification was shown or updated */
+static gboolean
 notify (const gchar *title,
 		const gchar *body,
 		PurpleBuddy *buddy,
@@ -296,29 +563,27 @@ notify (const gchar *title,
 	NotifyNotification *notification = NULL;
 	GdkPixbuf *icon;
 	PurpleBuddyIcon *buddy_icon;
+	gchar body_buf[ESCAPED_LEN(60)];
 	gchar *tr_body;
 	PurpleContact *contact;
 
+	if (!conv && buddy)
+		conv = purple_find_conversation_with_account (PURPLE_CONV_TYPE_ANY, buddy->name, buddy->account);
+
+	/* do not notify if the conversation is currently in focus */
+	if (conv_has_focus (conv))
+		return FALSE;
+
 	if (buddy)
 		contact = purple_buddy_get_contact (buddy);
 	else
 		contact = NULL;
 
 	if (body)
-		tr_body = truncate_escape_string (body, 60);
+		tr_body = truncate_escape_string (body, 60, body_buf);
 	else
 		tr_body = NULL;
 
-	if (!conv && buddy)
-		conv = purple_find_conversation_with_account (PURPLE_CONV_TYPE_ANY, buddy->name, buddy->account);
-
-	if (conv && conv->ui_ops && conv->ui_ops->has_focus) {
-	    if (conv->ui_ops->has_focus(conv) == TRUE) {
-		/* do not notify if the conversation is currently in focus */
-		return;
-	    }
-	}
-
 	if (contact)
 		notification = g_hash_table_lookup (buddy_hash, contact);
 	else if (conv)
@@ -336,8 +601,7 @@ notify (const gchar *title,
 						 "title: '%s', body: '%s', buddy: '%s'\n",
 						 title, tr_body, buddy ? best_name (buddy) : "");
 
-		g_free (tr_body);
-		return;
+		return TRUE;
 	}
 #ifdef LIBNOTIFY_07
 	notification = notify_notification_new (title, tr_body, NULL);
@@ -348,8 +612,6 @@ notify (const gchar *title,
 					 "title: '%s', body: '%s', buddy: '%s'\n",
 					 title, tr_body, buddy ? best_name (buddy) : "");
 
-	g_free (tr_body);
-
 	if (buddy)
 		buddy_icon = purple_buddy_get_icon (buddy);
 	else
@@ -394,15 +656,217 @@ notify (const gchar *title,
 	notify_notification_set_timeout(notification, purple_prefs_get_int("/plugins/gtk/libnotify/timeout"));
 	if (!notify_notification_show (notification, NULL)) {
 		purple_debug_error (PLUGIN_ID, "notify(), failed to send notification\n");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+notify_presence (PurpleBuddy *buddy,
+				 gboolean signon)
+{
+	gchar tr_name[ESCAPED_LEN(25)], title[ESCAPED_LEN(25) + 64];
+
+	truncate_escape_string (best_name (buddy), 25, tr_name);
+
+	if (signon)
+		g_snprintf (title, sizeof (title), _("%s signed on"), tr_name);
+	else
+		g_snprintf (title, sizeof (title), _("%s signed off"), tr_name);
+
+	if (notify (title, NULL, buddy, NULL))
+		history_append (buddy->account, best_name (buddy),
+						signon ? _("signed on") : _("signed off"));
+}
+
+/* presence changes arriving within PRESENCE_WINDOW msec of the previous
+ * one are collected and shown as a single notification, a burst is
+ * never held back for longer than PRESENCE_WINDOW_MAX msec */
+#define PRESENCE_WINDOW 2000
+#define PRESENCE_WINDOW_MAX 10000
+/* contacts remembered per burst, any more are only counted */
+#define PRESENCE_BURST_SIZE 16
+
+/* a burst is kept per contact, so one person signing on through
+ * several accounts counts once, like notify() shows them once */
+typedef struct {
+	gboolean signon;
+	PurpleBuddy *buddies[PRESENCE_BURST_SIZE];	/* first buddy of each contact */
+	guint count;
+	guint dropped;			/* contacts that did not fit */
+	guint timer;
+	gint64 started;			/* monotonic, usec */
+} PresenceBurst;
+
+static PresenceBurst signon_burst = { TRUE };
+static PresenceBurst signoff_burst = { FALSE };
+
+/* a popup summarizing several buddies: it belongs to no single contact
+ * or conversation, so it is not tracked in buddy_hash and has no
+ * "Show" action; returns TRUE if it was shown */
+static gboolean
+notify_burst (const gchar *title,
+			  const gchar *names,
+			  PurpleBuddy *first)
+{
+	NotifyNotification *notification;
+	gchar body_buf[ESCAPED_LEN(60)];
+	GdkPixbuf *icon;
+
+	truncate_escape_string (names, 60, body_buf);
+
+#ifdef LIBNOTIFY_07
+	notification = notify_notification_new (title, body_buf, NULL);
+#else
+	notification = notify_notification_new (title, body_buf, NULL, NULL);
+#endif
+	purple_debug_info (PLUGIN_ID, "notify_burst(), "
+					 "title: '%s', body: '%s'\n", title, body_buf);
+
+	icon = pidgin_create_prpl_icon (first->account, 1);
+	if (icon) {
+		notify_notification_set_icon_from_pixbuf (notification, icon);
+		g_object_unref (icon);
+	}
+
+	g_signal_connect (notification, "closed", G_CALLBACK(closed_cb), NULL);
+
+	notify_notification_set_urgency (notification, NOTIFY_URGENCY_NORMAL);
+
+	notify_notification_set_timeout(notification, purple_prefs_get_int("/plugins/gtk/libnotify/timeout"));
+	if (!notify_notification_show (notification, NULL)) {
+		purple_debug_error (PLUGIN_ID, "notify_burst(), failed to send notification\n");
+		return FALSE;
 	}
 
+	return TRUE;
+}
+
+static gboolean
+presence_burst_cb (gpointer data)
+{
+	PresenceBurst *burst;
+	guint count, i;
+	gboolean shown;
+
+	burst = (PresenceBurst *)data;
+	burst->timer = 0;
+
+	count = burst->count + burst->dropped;
+
+	purple_debug_info (PLUGIN_ID, "presence_burst_cb(), %u contacts signed %s\n",
+					 count, burst->signon ? "on" : "off");
+
+	if (burst->count == 0) {
+		/* everyone we remembered was removed from the buddy list */
+	} else if (count == 1) {
+		notify_presence (burst->buddies[0], burst->signon);
+	} else {
+		gchar title[128], names[256];
+
+		if (burst->signon)
+			g_snprintf (title, sizeof (title),
+						dngettext (PACKAGE, "%u buddy signed on", "%u buddies signed on", count),
+						count);
+		else
+			g_snprintf (title, sizeof (title),
+						dngettext (PACKAGE, "%u buddy signed off", "%u buddies signed off", count),
+						count);
+
+		/* the body is cut to 60 characters, no need to list everyone */
+		names[0] = '\0';
+		for (i = 0; i < burst->count && strlen (names) < 128; i++) {
+			if (i)
+				g_strlcat (names, ", ", sizeof (names));
+			g_strlcat (names, best_name (burst->buddies[i]), sizeof (names));
+		}
+
+		shown = notify_burst (title, names, burst->buddies[0]);
+
+		/* one history entry per contact, a burst may span several accounts */
+		for (i = 0; shown && i < burst->count; i++)
+			history_append (burst->buddies[i]->account, best_name (burst->buddies[i]),
+							burst->signon ? _("signed on") : _("signed off"));
+	}
+
+	burst->count = 0;
+	burst->dropped = 0;
+
+	return FALSE;
+}
+
+static void
+presence_burst_add (PresenceBurst *burst,
+					PurpleBuddy *buddy)
+{
+	PurpleContact *contact;
+	guint i;
+
+	contact = purple_buddy_get_contact (buddy);
+
+	for (i = 0; i < burst->count; i++)
+		if (purple_buddy_get_contact (burst->buddies[i]) == contact)
+			break;
+
+	if (i == burst->count) {
+		if (burst->count < PRESENCE_BURST_SIZE)
+			burst->buddies[burst->count++] = buddy;
+		else
+			burst->dropped++;
+	}
+
+	if (burst->timer) {
+		/* slide the window unless the burst has been going on for too long */
+		if (g_get_monotonic_time () - burst->started >= PRESENCE_WINDOW_MAX * 1000)
+			return;
+		g_source_remove (burst->timer);
+	} else {
+		burst->started = g_get_monotonic_time ();
+	}
+
+	burst->timer = g_timeout_add (PRESENCE_WINDOW, presence_burst_cb, burst);
+}
+
+static void
+presence_burst_clear (PresenceBurst *burst)
+{
+	if (burst->timer)
+		g_source_remove (burst->timer);
+	burst->timer = 0;
+
+	burst->count = 0;
+	burst->dropped = 0;
+}
+
+static void
+presence_burst_remove (PresenceBurst *burst,
+					   PurpleBuddy *buddy)
+{
+	guint i;
+
+	for (i = 0; i < burst->count; i++) {
+		if (burst->buddies[i] == buddy) {
+			memmove (&burst->buddies[i], &burst->buddies[i + 1],
+					 (burst->count - i - 1) * sizeof (PurpleBuddy *));
+			burst->count--;
+			return;
+		}
+	}
+}
+
+static void
+notify_buddy_removed_cb (PurpleBuddy *buddy,
+						 gpointer data)
+{
+	presence_burst_remove (&signon_burst, buddy);
+	presence_burst_remove (&signoff_burst, buddy);
 }
 
 static void
 notify_buddy_signon_cb (PurpleBuddy *buddy,
 						gpointer data)
 {
-	gchar *tr_name, *title;
 	gboolean blocked;
 
 	g_return_if_fail (buddy);
@@ -420,21 +884,13 @@ notify_buddy_signon_cb (PurpleBuddy *buddy,
 	if (!should_notify_unavailable (purple_buddy_get_account (buddy)))
 		return;
 
-	tr_name = truncate_escape_string (best_name (buddy), 25);
-
-	title = g_strdup_printf (_("%s signed on"), tr_name);
-
-	notify (title, NULL, buddy, NULL);
-
-	g_free (tr_name);
-	g_free (title);
+	presence_burst_add (&signon_burst, buddy);
 }
 
 static void
 notify_buddy_signoff_cb (PurpleBuddy *buddy,
 						 gpointer data)
 {
-	gchar *tr_name, *title;
 	gboolean blocked;
 
 	g_return_if_fail (buddy);
@@ -452,14 +908,204 @@ notify_buddy_signoff_cb (PurpleBuddy *buddy,
 	if (!should_notify_unavailable (purple_buddy_get_account (buddy)))
 		return;
 
-	tr_name = truncate_escape_string (best_name (buddy), 25);
+	presence_burst_add (&signoff_burst, buddy);
+}
+
+/* recently shown messages, used to drop copies of the same message
+ * arriving through several accounts or bridged rooms */
+#define DEDUP_SIZE 16
+
+typedef struct {
+	guint32 hash;
+	gint64 time;			/* monotonic, msec */
+	gpointer owner;			/* buddy_hash key of the popup, NULL if unused */
+} DedupEntry;
+
+static DedupEntry dedup_entries[DEDUP_SIZE];
+static guint dedup_next = 0;
+
+#define FNV_OFFSET 2166136261U
+#define FNV_PRIME 16777619U
+
+static guint32
+dedup_hash_bytes (guint32 hash,
+				  const guchar *data,
+				  gsize len)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ data[i]) * FNV_PRIME;
+
+	return hash;
+}
+
+static const struct {
+	const gchar *name;
+	gsize len;
+	gchar c;
+} markup_entities[] = {
+	{ "&amp;", 5, '&' },
+	{ "&lt;", 4, '<' },
+	{ "&gt;", 4, '>' },
+	{ "&quot;", 6, '"' },
+	{ "&apos;", 6, '\'' },
+	{ "&#39;", 5, '\'' },
+	{ "&nbsp;", 6, ' ' }
+};
+
+/* returns the next byte of the text purple_markup_strip_html() would
+ * leave and advances *text past it, or '\0' at the end: tags are
+ * skipped, <br> becomes a newline and the common entities are decoded */
+static gchar
+markup_next_char (const gchar **text)
+{
+	const gchar *p = *text;
+	guint i;
+
+	while (*p == '<') {
+		const gchar *close = strchr (p, '>');
+
+		if (!close)
+			break;
+
+		p = close + 1;
+		if (g_ascii_strncasecmp (*text + 1, "br", 2) == 0 && !g_ascii_isalnum ((*text)[3])) {
+			*text = p;
+			return '\n';
+		}
+		*text = p;
+	}
+
+	if (*p == '\0')
+		return '\0';
+
+	if (*p == '&') {
+		for (i = 0; i < G_N_ELEMENTS (markup_entities); i++) {
+			if (strncmp (p, markup_entities[i].name, markup_entities[i].len) == 0) {
+				*text = p + markup_entities[i].len;
+				return markup_entities[i].c;
+			}
+		}
+	}
+
+	*text = p + 1;
+	return *p;
+}
+
+/* strips markup into buf without allocating, cut to at most size-1
+ * bytes and to the valid utf-8 prefix; returns buf */
+static gchar *
+strip_markup (const gchar *markup,
+			  gchar *buf,
+			  gsize size)
+{
+	const gchar *p = markup, *end;
+	gsize len = 0;
+	gchar c;
+
+	while (len < size - 1 && (c = markup_next_char (&p)))
+		buf[len++] = c;
+	buf[len] = '\0';
+
+	g_utf8_validate (buf, len, &end);
+	buf[end - buf] = '\0';
+
+	return buf;
+}
+
+/* hashes the text with ascii case folded, leading and trailing
+ * whitespace dropped and inner whitespace runs collapsed; with markup
+ * set it hashes the stripped text, see markup_next_char() */
+static guint32
+dedup_hash_text (guint32 hash,
+				 const gchar *text,
+				 gboolean markup)
+{
+	gboolean space = FALSE, started = FALSE;
+	const gchar *p = text;
+	gchar c;
+
+	while ((c = markup ? markup_next_char (&p) : *p++)) {
+		if (g_ascii_isspace (c)) {
+			space = TRUE;
+			continue;
+		}
+		if (space && started)
+			hash = (hash ^ ' ') * FNV_PRIME;
+		space = FALSE;
+		started = TRUE;
+		hash = (hash ^ (guchar)g_ascii_tolower (c)) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/* the key is the metacontact if there is one, so the same person on
+ * several accounts matches, otherwise the sender name */
+static guint32
+dedup_hash (PurpleContact *contact,
+			const gchar *sender,
+			const gchar *message)
+{
+	guint32 hash = FNV_OFFSET;
+
+	if (contact)
+		hash = dedup_hash_bytes (hash, (const guchar *)&contact, sizeof (contact));
+	else
+		hash = dedup_hash_text (hash, sender, FALSE);
+
+	hash = (hash ^ 0) * FNV_PRIME;
+
+	return dedup_hash_text (hash, message, TRUE);
+}
+
+static gint64
+dedup_now (void)
+{
+	return g_get_monotonic_time () / 1000;
+}
+
+/* a copy is only dropped while the popup showing the first one is
+ * still up, otherwise there would be nothing to fold it into */
+static gboolean
+dedup_is_duplicate (guint32 hash)
+{
+	gint64 now;
+	int window, i;
 
-	title = g_strdup_printf (_("%s signed off"), tr_name);
+	window = purple_prefs_get_int ("/plugins/gtk/libnotify/dedup_window");
+	if (window <= 0)
+		return FALSE;
 
-	notify (title, NULL, buddy, NULL);
+	now = dedup_now ();
 
-	g_free (tr_name);
-	g_free (title);
+	for (i = 0; i < DEDUP_SIZE; i++) {
+		DedupEntry *entry = &dedup_entries[i];
+
+		if (entry->owner && entry->hash == hash &&
+			now - entry->time < window &&
+			g_hash_table_lookup (buddy_hash, entry->owner)) {
+			dedup_suppressed++;
+			purple_debug_info (PLUGIN_ID, "dedup_is_duplicate(), dropped duplicate message, "
+							 "%u suppressed so far\n", dedup_suppressed);
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+dedup_record (guint32 hash,
+			  gpointer owner)
+{
+	DedupEntry *entry;
+
+	entry = &dedup_entries[dedup_next++ % DEDUP_SIZE];
+	entry->hash = hash;
+	entry->time = dedup_now ();
+	entry->owner = owner;
 }
 
 static void
@@ -469,38 +1115,65 @@ notify_msg_sent (PurpleAccount *account,
 				 const gchar *message)
 {
 	PurpleBuddy *buddy;
-	gchar *title, *body, *tr_name;
-	gboolean blocked;
+	PurpleContact *contact;
+	gchar tr_name[ESCAPED_LEN(25)], title[ESCAPED_LEN(25) + 64];
+	/* notify() shows 60 characters, this holds more than that */
+	gchar body[256];
+	guint32 hash;
+	gboolean blocked, shown;
 
 	blocked = purple_prefs_get_bool ("/plugins/gtk/libnotify/blocked");
 	if (blocked && !purple_privacy_check(account, sender))
 		return;
 
 	buddy = purple_find_buddy (account, sender);
+
+	if (!conv && buddy)
+		conv = purple_find_conversation_with_account (PURPLE_CONV_TYPE_ANY, buddy->name, buddy->account);
+
+	/* check before building any strings, notify() would drop it anyway */
+	if (conv_has_focus (conv))
+		return;
+
+	contact = buddy ? purple_buddy_get_contact (buddy) : NULL;
+
+	/* the popup for the first copy is still up, leave it alone */
+	hash = dedup_hash (contact, sender, message);
+	if (dedup_is_duplicate (hash))
+		return;
+
 	if (buddy)
-		tr_name = truncate_escape_string (best_name (buddy), 25);
+		truncate_escape_string (best_name (buddy), 25, tr_name);
 	else if (conv) {
-		char *name = g_strdup_printf (_("%s (%s)"), sender, purple_conversation_get_name (conv));
-		tr_name = truncate_escape_string (name, 25);
-		g_free (name);
+		/* anything longer than this is cut to 25 chars anyway */
+		gchar name[256];
+
+		g_snprintf (name, sizeof (name), _("%s (%s)"), sender, purple_conversation_get_name (conv));
+		truncate_escape_string (name, 25, tr_name);
 	} else
-		tr_name = truncate_escape_string (sender, 25);
+		truncate_escape_string (sender, 25, tr_name);
 
 	if (purple_prefs_get_bool("/plugins/gtk/libnotify/newmsgtxt")) {
-		title = g_strdup_printf (_("%s says:"), tr_name);
-		body = purple_markup_strip_html (message);
+		g_snprintf (title, sizeof (title), _("%s says:"), tr_name);
+		strip_markup (message, body, sizeof (body));
 
-		notify (title, body, buddy, conv);
-
-		g_free (title);
+		shown = notify (title, body, buddy, conv);
+		if (shown)
+			history_append (account, buddy ? best_name (buddy) : sender, body);
 	} else {
-		title = _("new message received");
-		body = g_strdup_printf (_("from %s"), tr_name);
+		gchar from[ESCAPED_LEN(25) + 64];
+
+		g_snprintf (from, sizeof (from), _("from %s"), tr_name);
 
-		notify (title, body, buddy, conv);
+		shown = notify (_("new message received"), from, buddy, conv);
+		if (shown)
+			history_append (account, buddy ? best_name (buddy) : sender,
+							_("new message received"));
 	}
-	g_free (tr_name);
-	g_free (body);
+
+	/* the same key notify() filed the popup under */
+	if (shown && (contact || conv))
+		dedup_record (hash, contact ? (gpointer)contact : (gpointer)conv);
 }
 
 static void
@@ -570,12 +1243,17 @@ plugin_load (PurplePlugin *plugin)
 
 	buddy_hash = g_hash_table_new (NULL, NULL);
 
+	history_open ();
+
 	purple_signal_connect (blist_handle, "buddy-signed-on", plugin,
 						PURPLE_CALLBACK(notify_buddy_signon_cb), NULL);
 
 	purple_signal_connect (blist_handle, "buddy-signed-off", plugin,
 						PURPLE_CALLBACK(notify_buddy_signoff_cb), NULL);
 
+	purple_signal_connect (blist_handle, "buddy-removed", plugin,
+						PURPLE_CALLBACK(notify_buddy_removed_cb), NULL);
+
 	purple_signal_connect (conv_handle, "received-im-msg", plugin,
 						PURPLE_CALLBACK(notify_new_message_cb), NULL);
 
@@ -608,6 +1286,9 @@ plugin_unload (PurplePlugin *plugin)
 	purple_signal_disconnect (blist_handle, "buddy-signed-off", plugin,
 							PURPLE_CALLBACK(notify_buddy_signoff_cb));
 
+	purple_signal_disconnect (blist_handle, "buddy-removed", plugin,
+							PURPLE_CALLBACK(notify_buddy_removed_cb));
+
 	purple_signal_disconnect (conv_handle, "received-im-msg", plugin,
 							PURPLE_CALLBACK(notify_new_message_cb));
 
@@ -621,8 +1302,13 @@ plugin_unload (PurplePlugin *plugin)
 	purple_signal_disconnect (conn_handle, "signed-on", plugin,
 							PURPLE_CALLBACK(event_connection_throttle));
 
+	presence_burst_clear (&signon_burst);
+	presence_burst_clear (&signoff_burst);
+
 	g_hash_table_destroy (buddy_hash);
 
+	history_close ();
+
 	notify_uninit ();
 
 	return TRUE;
@@ -658,7 +1344,8 @@ static PurplePluginInfo info = {
     NULL,					/* destroy */
     NULL,					/* ui info */
     NULL,					/* extra info */
-    &prefs_info				/* prefs info */
+    &prefs_info,			/* prefs info */
+    plugin_actions			/* actions */
 };
 
 static void
@@ -676,6 +1363,8 @@ init_plugin (PurplePlugin *plugin)
 	purple_prefs_add_bool ("/plugins/gtk/libnotify/newmsgtxt", TRUE);
 	purple_prefs_add_bool ("/plugins/gtk/libnotify/othermsgs", TRUE);
 	purple_prefs_add_bool ("/plugins/gtk/libnotify/blocked", TRUE);
+	purple_prefs_add_int ("/plugins/gtk/libnotify/history_show", 20);
+	purple_prefs_add_int ("/plugins/gtk/libnotify/dedup_window", 3000);
 	purple_prefs_add_bool ("/plugins/gtk/libnotify/newconvonly", FALSE);
 	purple_prefs_add_bool ("/plugins/gtk/libnotify/signon", TRUE);
 	purple_prefs_add_bool ("/plugins/gtk/libnotify/signoff", FALSE);
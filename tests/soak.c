@@ -0,0 +1,883 @@
+/*
+ * Pidgin-libnotify - Provides a libnotify interface for Pidgin
+ * Copyright (C) 2005-2007 Duarte Henriques
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* Replays a million synthetic IM, chat and presence events through the
+ * plugin's signal handlers, with malloc() and friends counted by a shim.
+ * Events the plugin filters out must not allocate at all, delivered
+ * ones no more than the notification on average, and neither the
+ * number of live allocations nor the resident set may grow once the
+ * popups have expired.
+ *
+ * The plugin is built into this program against stub headers, see
+ * stubs/purple-stubs.h.  The stubs here never allocate on their own
+ * except where the real function returns new memory, so what the shim
+ * counts is the plugin's own work.  Lookups such as purple_find_buddy()
+ * do allocate inside a real libpurple; that is outside the plugin. */
+
+#include "pidgin-libnotify.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SOAK_EVENTS 1000000
+#define SOAK_EXPIRE_EVERY 1000		/* events between popup timeouts */
+#define SOAK_WARMUP 100000
+#define SOAK_SAMPLE_EVERY 100000	/* events between resident set samples */
+#define SOAK_RSS_SLACK (512 * 1024)
+#define SOAK_LIVE_SLACK 16
+
+/* malloc shim */
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void *__libc_memalign (size_t alignment, size_t size);
+extern void __libc_free (void *ptr);
+
+static unsigned long allocs = 0;	/* every call that returns new memory */
+static long live = 0;				/* allocations not freed yet */
+
+void *
+malloc (size_t size)
+{
+	allocs++;
+	live++;
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+	allocs++;
+	live++;
+	return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+	allocs++;
+	if (!ptr)
+		live++;
+	return __libc_realloc (ptr, size);
+}
+
+void *
+memalign (size_t alignment, size_t size)
+{
+	allocs++;
+	live++;
+	return __libc_memalign (alignment, size);
+}
+
+void *
+aligned_alloc (size_t alignment, size_t size)
+{
+	return memalign (alignment, size);
+}
+
+int
+posix_memalign (void **memptr, size_t alignment, size_t size)
+{
+	*memptr = memalign (alignment, size);
+	return *memptr ? 0 : ENOMEM;
+}
+
+void
+free (void *ptr)
+{
+	if (ptr)
+		live--;
+	__libc_free (ptr);
+}
+
+/* synthetic world: 3 accounts, 64 buddies in 32 contacts, so buddy i and
+ * i + 32 are the same person on two different accounts */
+
+#define N_ACCOUNTS 3
+#define N_BUDDIES 64
+#define N_CONTACTS 32
+#define N_CHATS 4
+
+struct _PurpleContact {
+	int id;
+};
+
+static PurpleConnection connections[N_ACCOUNTS];
+static PurpleAccount accounts[N_ACCOUNTS] = {
+	{ "alice@jabber.example", NULL, TRUE },
+	{ "alice@icq.example", NULL, TRUE },
+	{ "alice@irc.example", NULL, TRUE }
+};
+static PurpleContact contacts[N_CONTACTS];
+static PurpleBuddy buddies[N_BUDDIES];
+static gchar buddy_names[N_BUDDIES][16];
+static gchar buddy_aliases[N_BUDDIES][32];
+static PurpleConversation ims[N_BUDDIES];
+static PurpleConversation chats[N_CHATS];
+
+static gboolean
+soak_has_focus (PurpleConversation *conv)
+{
+	return conv->focus;
+}
+
+static void
+soak_present (PurpleConversation *conv)
+{
+}
+
+static PurpleConversationUiOps ui_ops = { soak_has_focus, soak_present };
+
+static void
+world_init (void)
+{
+	int i;
+
+	for (i = 0; i < N_ACCOUNTS; i++) {
+		connections[i].account = &accounts[i];
+		accounts[i].gc = &connections[i];
+	}
+
+	for (i = 0; i < N_CONTACTS; i++)
+		contacts[i].id = i;
+
+	for (i = 0; i < N_BUDDIES; i++) {
+		g_snprintf (buddy_names[i], sizeof (buddy_names[i]), "buddy%d", i);
+		/* some aliases need escaping and truncating */
+		g_snprintf (buddy_aliases[i], sizeof (buddy_aliases[i]),
+					i % 4 ? "Bud <%d> & Co. with a long alias" : "Bud %d", i);
+
+		buddies[i].name = buddy_names[i];
+		buddies[i].alias = i % 2 ? buddy_aliases[i] : NULL;
+		buddies[i].server_alias = i % 3 ? buddy_aliases[i] : NULL;
+		buddies[i].account = &accounts[i % N_ACCOUNTS];
+		buddies[i].contact = &contacts[i % N_CONTACTS];
+		buddies[i].blocked = (i % 16 == 15);
+
+		/* every 8th buddy has its conversation in focus, some others
+		 * have one open in the background */
+		ims[i].ui_ops = &ui_ops;
+		ims[i].account = buddies[i].account;
+		ims[i].name = buddy_names[i];
+		ims[i].open = (i % 8 == 3 || i % 8 == 5);
+		ims[i].focus = (i % 8 == 3);
+	}
+
+	for (i = 0; i < N_CHATS; i++) {
+		chats[i].ui_ops = &ui_ops;
+		chats[i].account = &accounts[i % N_ACCOUNTS];
+		chats[i].name = i % 2 ? "#pidgin" : "#libnotify";
+		chats[i].nick = "alice";
+		chats[i].open = TRUE;
+		chats[i].focus = FALSE;
+	}
+}
+
+static PurpleBuddy *
+world_find_buddy (const PurpleAccount *account,
+				  const char *name)
+{
+	int i;
+
+	for (i = 0; i < N_BUDDIES; i++)
+		if (buddies[i].account == account && !strcmp (buddies[i].name, name))
+			return &buddies[i];
+
+	return NULL;
+}
+
+/* libpurple stubs */
+
+static struct {
+	const char *name;
+	int value;
+} prefs[32];
+static int n_prefs = 0;
+
+static int *
+pref_find (const char *name)
+{
+	int i;
+
+	for (i = 0; i < n_prefs; i++)
+		if (!strcmp (prefs[i].name, name))
+			return &prefs[i].value;
+
+	return NULL;
+}
+
+static void
+pref_set (const char *name,
+		  int value)
+{
+	int *pref = pref_find (name);
+
+	if (!pref) {
+		g_assert (n_prefs < (int)G_N_ELEMENTS (prefs));
+		prefs[n_prefs].name = name;
+		pref = &prefs[n_prefs++].value;
+	}
+	*pref = value;
+}
+
+void purple_prefs_add_none (const char *name) { }
+void purple_prefs_add_bool (const char *name, gboolean value) { if (!pref_find (name)) pref_set (name, value); }
+void purple_prefs_add_int (const char *name, int value) { if (!pref_find (name)) pref_set (name, value); }
+gboolean purple_prefs_get_bool (const char *name) { int *p = pref_find (name); return p ? *p : FALSE; }
+int purple_prefs_get_int (const char *name) { int *p = pref_find (name); return p ? *p : 0; }
+void purple_prefs_set_bool (const char *name, gboolean value) { pref_set (name, value); }
+void purple_prefs_set_int (const char *name, int value) { pref_set (name, value); }
+
+/* with debugging off libpurple returns before formatting anything */
+void purple_debug_info (const char *category, const char *format, ...) { }
+void purple_debug_warning (const char *category, const char *format, ...) { }
+void purple_debug_error (const char *category, const char *format, ...) { }
+
+PurplePluginPrefFrame *purple_plugin_pref_frame_new (void) { return NULL; }
+void purple_plugin_pref_frame_add (PurplePluginPrefFrame *frame, PurplePluginPref *pref) { }
+PurplePluginPref *purple_plugin_pref_new_with_name_and_label (const char *name, const char *label) { return NULL; }
+void purple_plugin_pref_set_bounds (PurplePluginPref *pref, int min, int max) { }
+PurplePluginAction *purple_plugin_action_new (const char *label, void (*callback) (PurplePluginAction *)) { return NULL; }
+
+static guint history_dialogs = 0;
+
+void *
+purple_notify_info (void *handle, const char *title,
+					const char *primary, const char *secondary)
+{
+	return NULL;
+}
+
+void *
+purple_notify_formatted (void *handle, const char *title, const char *primary,
+						 const char *secondary, const char *text,
+						 GCallback cb, gpointer user_data)
+{
+	history_dialogs++;
+	return NULL;
+}
+
+PurpleConnection *purple_account_get_connection (const PurpleAccount *account) { return account->gc; }
+gboolean purple_account_is_connected (const PurpleAccount *account) { return TRUE; }
+const char *purple_account_get_username (const PurpleAccount *account) { return account->username; }
+PurpleStatus *purple_account_get_active_status (const PurpleAccount *account) { return (PurpleStatus *)account; }
+gboolean purple_status_is_online (const PurpleStatus *status) { return TRUE; }
+gboolean purple_status_is_available (const PurpleStatus *status) { return ((const PurpleAccount *)status)->available; }
+PurpleAccount *purple_connection_get_account (const PurpleConnection *gc) { return gc->account; }
+
+gboolean
+purple_privacy_check (PurpleAccount *account,
+					  const char *who)
+{
+	PurpleBuddy *buddy = world_find_buddy (account, who);
+
+	return !buddy || !buddy->blocked;
+}
+
+PurpleBuddy *purple_find_buddy (PurpleAccount *account, const char *name) { return world_find_buddy (account, name); }
+PurpleContact *purple_buddy_get_contact (PurpleBuddy *buddy) { return buddy->contact; }
+PurpleAccount *purple_buddy_get_account (const PurpleBuddy *buddy) { return buddy->account; }
+PurpleBuddyIcon *purple_buddy_get_icon (const PurpleBuddy *buddy) { return NULL; }
+gconstpointer purple_buddy_icon_get_data (const PurpleBuddyIcon *icon, size_t *len) { *len = 0; return NULL; }
+
+PurpleConversation *
+purple_find_conversation_with_account (PurpleConversationType type,
+									   const char *name,
+									   const PurpleAccount *account)
+{
+	PurpleBuddy *buddy = world_find_buddy (account, name);
+
+	if (!buddy || !ims[buddy - buddies].open)
+		return NULL;
+
+	return &ims[buddy - buddies];
+}
+
+PurpleConversation *
+purple_conversation_new (PurpleConversationType type,
+						 PurpleAccount *account,
+						 const char *name)
+{
+	PurpleConversation *conv = &ims[world_find_buddy (account, name) - buddies];
+
+	conv->open = TRUE;
+	return conv;
+}
+
+const char *purple_conversation_get_name (const PurpleConversation *conv) { return conv->name; }
+gboolean purple_conversation_has_focus (PurpleConversation *conv) { return conv->focus; }
+const char *purple_conv_chat_get_nick (PurpleConvChat *chat) { return ((PurpleConversation *)chat)->nick; }
+
+/* the real one returns a new string too */
+char *
+purple_markup_strip_html (const char *str)
+{
+	gchar *stripped, *out;
+	const gchar *p;
+	gboolean in_tag = FALSE;
+
+	stripped = out = g_malloc (strlen (str) + 1);
+	for (p = str; *p; p++) {
+		if (*p == '<')
+			in_tag = TRUE;
+		else if (*p == '>')
+			in_tag = FALSE;
+		else if (!in_tag)
+			*out++ = *p;
+	}
+	*out = '\0';
+
+	return stripped;
+}
+
+const char *purple_date_format_full (const struct tm *tm) { return "Mon 19 Oct 2026 12:00:00"; }
+
+static gchar *user_dir = NULL;
+
+const char *purple_user_dir (void) { return user_dir; }
+
+void *purple_conversations_get_handle (void) { return &ims; }
+void *purple_blist_get_handle (void) { return &buddies; }
+void *purple_connections_get_handle (void) { return &connections; }
+gulong purple_signal_connect (void *instance, const char *signal, void *handle, gpointer func, void *data) { return 1; }
+void purple_signal_disconnect (void *instance, const char *signal, void *handle, gpointer func) { }
+
+GdkPixbuf *pidgin_create_prpl_icon (PurpleAccount *account, int size) { return NULL; }
+
+GdkPixbufLoader *gdk_pixbuf_loader_new (void) { return NULL; }
+void gdk_pixbuf_loader_set_size (GdkPixbufLoader *loader, int width, int height) { }
+gboolean gdk_pixbuf_loader_write (GdkPixbufLoader *loader, const guchar *buf, gsize count, GError **error) { return TRUE; }
+gboolean gdk_pixbuf_loader_close (GdkPixbufLoader *loader, GError **error) { return TRUE; }
+GdkPixbuf *gdk_pixbuf_loader_get_pixbuf (GdkPixbufLoader *loader) { return NULL; }
+
+/* timers */
+
+static struct {
+	guint tag;
+	GSourceFunc function;
+	gpointer data;
+} timers[8];
+static guint next_tag = 1;
+
+guint
+soak_timeout_add (guint interval,
+				  GSourceFunc function,
+				  gpointer data)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (timers); i++) {
+		if (!timers[i].tag) {
+			timers[i].tag = next_tag++;
+			timers[i].function = function;
+			timers[i].data = data;
+			return timers[i].tag;
+		}
+	}
+
+	g_error ("soak: out of timer slots");
+	return 0;
+}
+
+gboolean
+soak_source_remove (guint tag)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (timers); i++) {
+		if (timers[i].tag == tag) {
+			timers[i].tag = 0;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* fires every pending timer once, as if its interval had passed */
+static void
+timers_fire (void)
+{
+	guint i, tag;
+
+	for (i = 0; i < G_N_ELEMENTS (timers); i++) {
+		tag = timers[i].tag;
+		if (tag && !timers[i].function (timers[i].data) && timers[i].tag == tag)
+			timers[i].tag = 0;
+	}
+}
+
+/* libnotify and gobject stubs: a notification is the one allocation
+ * that libnotify keeps for a shown popup */
+
+struct _NotifyNotification {
+	gint ref;
+	gpointer contact;
+	gpointer conv;
+	gpointer buddy;
+	gboolean (*closed) (NotifyNotification *notification);
+	guint slot;
+};
+
+static NotifyNotification *popups[256];
+static guint n_popups = 0;
+static gulong popups_shown = 0;
+
+gboolean notify_init (const char *app_name) { return TRUE; }
+void notify_uninit (void) { }
+gboolean notify_is_initted (void) { return TRUE; }
+
+NotifyNotification *
+#ifdef LIBNOTIFY_07
+notify_notification_new (const char *summary, const char *body, const char *icon)
+#else
+notify_notification_new (const char *summary, const char *body, const char *icon, gpointer attach)
+#endif
+{
+	NotifyNotification *notification;
+
+	g_assert (n_popups < G_N_ELEMENTS (popups));
+
+	notification = g_new0 (NotifyNotification, 1);
+	notification->ref = 1;
+	notification->slot = n_popups;
+	popups[n_popups++] = notification;
+
+	return notification;
+}
+
+gboolean notify_notification_update (NotifyNotification *notification, const char *summary, const char *body, const char *icon) { return TRUE; }
+gboolean notify_notification_show (NotifyNotification *notification, GError **error) { popups_shown++; return TRUE; }
+void notify_notification_set_timeout (NotifyNotification *notification, gint timeout) { }
+void notify_notification_set_urgency (NotifyNotification *notification, NotifyUrgency urgency) { }
+void notify_notification_set_icon_from_pixbuf (NotifyNotification *notification, GdkPixbuf *icon) { }
+void notify_notification_add_action (NotifyNotification *notification, const char *action, const char *label, NotifyActionCallback callback, gpointer user_data, GFreeFunc free_func) { }
+
+gboolean
+notify_notification_close (NotifyNotification *notification,
+						   GError **error)
+{
+	return notification->closed (notification);
+}
+
+gpointer
+g_object_ref (gpointer object)
+{
+	((NotifyNotification *)object)->ref++;
+	return object;
+}
+
+void
+g_object_unref (gpointer object)
+{
+	NotifyNotification *notification = object;
+
+	if (--notification->ref > 0)
+		return;
+
+	/* move the last popup into the freed slot */
+	popups[notification->slot] = popups[--n_popups];
+	popups[notification->slot]->slot = notification->slot;
+	g_free (notification);
+}
+
+gpointer
+g_object_get_data (gpointer object,
+				   const gchar *key)
+{
+	NotifyNotification *notification = object;
+
+	if (!strcmp (key, "contact"))
+		return notification->contact;
+	if (!strcmp (key, "conv"))
+		return notification->conv;
+	if (!strcmp (key, "buddy"))
+		return notification->buddy;
+	return NULL;
+}
+
+void
+g_object_set_data (gpointer object,
+				   const gchar *key,
+				   gpointer data)
+{
+	NotifyNotification *notification = object;
+
+	if (!strcmp (key, "contact"))
+		notification->contact = data;
+	else if (!strcmp (key, "conv"))
+		notification->conv = data;
+	else if (!strcmp (key, "buddy"))
+		notification->buddy = data;
+}
+
+gulong
+g_signal_connect (gpointer instance,
+				  const gchar *signal,
+				  GCallback handler,
+				  gpointer data)
+{
+	g_assert (!strcmp (signal, "closed"));
+	((NotifyNotification *)instance)->closed = (gboolean (*) (NotifyNotification *))handler;
+	return 1;
+}
+
+/* every popup times out */
+static void
+popups_expire (void)
+{
+	while (n_popups)
+		popups[n_popups - 1]->closed (popups[n_popups - 1]);
+}
+
+/* the soak itself */
+
+static long
+rss_bytes (void)
+{
+	gchar buf[128];
+	long pages = 0, resident = 0;
+	FILE *f;
+
+	f = fopen ("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+	if (fgets (buf, sizeof (buf), f))
+		sscanf (buf, "%ld %ld", &pages, &resident);
+	fclose (f);
+
+	return resident * sysconf (_SC_PAGESIZE);
+}
+
+static guint32 rng = 2463534242U;
+
+static guint32
+rand_next (void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+/* the same text as different protocols might send it */
+static const gchar *messages[][2] = {
+	{ "<b>hi</b> there &amp; you", "HI there & you<br>" },
+	{ "are you <i>around</i>?", "  are you around? " },
+	{ "lunch at 12:30", "<font color=\"red\">lunch</font> at 12:30" },
+	{ "see https://example.org/?a=1&amp;b=2", "see https://example.org/?a=1&b=2" },
+	{ "\xc3\xa9t\xc3\xa9 \xe2\x80\x94 ok", "\xc3\xa9t\xc3\xa9   \xe2\x80\x94   ok" },
+	{ "alice: ping", "alice:  ping" },
+	{ "a message long enough to be cut down to sixty characters when it is shown in the popup",
+	  "a message long enough to be cut down to sixty characters when it is shown in the popup" },
+	{ "broken \xc2", "broken \xc2" }
+};
+
+enum {
+	EV_IM,				/* may be filtered by the buddy's state */
+	EV_IM_BLOCKED,
+	EV_IM_FOCUSED,
+	EV_IM_AWAY,
+	EV_IM_DUPLICATE,
+	EV_CHAT_MENTION,
+	EV_CHAT_OWN,
+	EV_CHAT_OTHER,
+	EV_SIGNON,
+	EV_SIGNON_THROTTLED,
+	EV_SIGNOFF,
+	EV_COUNT
+};
+
+static const gchar *event_names[EV_COUNT] = {
+	"im", "im from blocked buddy", "im in focused conversation",
+	"im while away", "duplicate im", "chat mention", "own chat message",
+	"other chat message", "signon", "signon while throttled", "signoff"
+};
+
+static unsigned long filtered_allocs[EV_COUNT];
+static unsigned long event_count[EV_COUNT];
+static unsigned long delivered = 0, delivered_allocs = 0;
+
+/* buddy on a given account, picked at random */
+static PurpleBuddy *
+pick_buddy (int account)
+{
+	int i;
+
+	do {
+		i = rand_next () % N_BUDDIES;
+	} while (i % N_ACCOUNTS != account);
+
+	return &buddies[i];
+}
+
+static void
+run_event (int kind)
+{
+	const gchar *(*msg)[2] = &messages[rand_next () % G_N_ELEMENTS (messages)];
+	PurpleBuddy *buddy;
+	unsigned long before, shown;
+	gboolean filtered;
+	guint i;
+
+	event_count[kind]++;
+
+	/* pick the inputs before counting */
+	switch (kind) {
+	case EV_IM_BLOCKED:
+		do {
+			buddy = pick_buddy (rand_next () % 2);
+		} while (!buddy->blocked);
+		break;
+	case EV_IM_FOCUSED:
+		do {
+			buddy = pick_buddy (rand_next () % 2);
+		} while (!ims[buddy - buddies].focus || buddy->blocked);
+		break;
+	case EV_IM_AWAY:
+		buddy = pick_buddy (2);
+		break;
+	case EV_IM_DUPLICATE:
+		/* a buddy on account 0 whose contact also has one on account 1 */
+		do {
+			buddy = pick_buddy (0);
+		} while (buddy->blocked || ims[buddy - buddies].focus ||
+				 buddies[(buddy - buddies + N_CONTACTS) % N_BUDDIES].blocked ||
+				 ims[(buddy - buddies + N_CONTACTS) % N_BUDDIES].focus ||
+				 buddies[(buddy - buddies + N_CONTACTS) % N_BUDDIES].account != &accounts[1]);
+
+		/* the first copy must not fold into an earlier popup itself */
+		{
+			NotifyNotification *notification = g_hash_table_lookup (buddy_hash, buddy->contact);
+
+			if (notification)
+				notification->closed (notification);
+		}
+		break;
+	case EV_SIGNON_THROTTLED:
+		buddy = pick_buddy (2);
+		break;
+	default:
+		buddy = pick_buddy (rand_next () % 2);
+		break;
+	}
+
+	before = allocs;
+	shown = popups_shown;
+	filtered = TRUE;
+
+	switch (kind) {
+	case EV_IM:
+		notify_new_message_cb (buddy->account, buddy->name, (*msg)[0], 0, NULL);
+		filtered = (popups_shown == shown);
+		break;
+	case EV_IM_BLOCKED:
+	case EV_IM_FOCUSED:
+	case EV_IM_AWAY:
+		notify_new_message_cb (buddy->account, buddy->name, (*msg)[0], 0, NULL);
+		break;
+	case EV_IM_DUPLICATE:
+		/* the first copy is a normal delivery, the second must fold */
+		notify_new_message_cb (buddy->account, buddy->name, (*msg)[0], 0, NULL);
+		g_assert (popups_shown > shown);
+		delivered++;
+		delivered_allocs += allocs - before;
+
+		buddy = &buddies[(buddy - buddies + N_CONTACTS) % N_BUDDIES];
+		before = allocs;
+		shown = popups_shown;
+		notify_new_message_cb (buddy->account, buddy->name, (*msg)[1], 0, NULL);
+		break;
+	case EV_CHAT_MENTION:
+		i = rand_next () % N_CHATS;
+		notify_chat_nick (chats[i].account, buddy->name, "alice: are you there?", &chats[i], NULL);
+		filtered = (popups_shown == shown);
+		break;
+	case EV_CHAT_OWN:
+		i = rand_next () % N_CHATS;
+		notify_chat_nick (chats[i].account, "alice", (*msg)[0], &chats[i], NULL);
+		break;
+	case EV_CHAT_OTHER:
+		i = rand_next () % N_CHATS;
+		notify_chat_nick (chats[i].account, buddy->name, "nothing for you here", &chats[i], NULL);
+		break;
+	case EV_SIGNON:
+		notify_buddy_signon_cb (buddy, NULL);
+		/* the popup only comes when the burst window closes */
+		filtered = buddy->blocked;
+		break;
+	case EV_SIGNON_THROTTLED:
+	case EV_SIGNOFF:
+		if (kind == EV_SIGNOFF)
+			notify_buddy_signoff_cb (buddy, NULL);
+		else
+			notify_buddy_signon_cb (buddy, NULL);
+		break;
+	}
+
+	if (filtered) {
+		if (popups_shown != shown) {
+			fprintf (stderr, "soak: %s event was not filtered\n", event_names[kind]);
+			exit (1);
+		}
+		filtered_allocs[kind] += allocs - before;
+	} else {
+		delivered++;
+		delivered_allocs += allocs - before;
+	}
+}
+
+int
+main (int argc,
+	  char **argv)
+{
+	PurplePlugin plugin;
+	PurplePluginAction action;
+	long warm_live = 0, warm_rss = 0, end_live, end_rss, rss, peak_rss = 0;
+	gchar *history_path;
+	gulong shown_before;
+	gboolean failed = FALSE;
+	int i;
+
+	/* glib before 2.76 has its own slice allocator, bypass it */
+	g_setenv ("G_SLICE", "always-malloc", TRUE);
+
+	user_dir = g_dir_make_tmp ("pidgin-libnotify-soak-XXXXXX", NULL);
+	g_assert (user_dir);
+	history_path = g_build_filename (user_dir, HISTORY_FILE, NULL);
+
+	world_init ();
+
+	purple_init_plugin (&plugin);
+	g_assert (plugin_load (&plugin));
+
+	purple_prefs_set_bool ("/plugins/gtk/libnotify/othermsgs", FALSE);
+	purple_prefs_set_bool ("/plugins/gtk/libnotify/only_available", TRUE);
+	purple_prefs_set_int ("/plugins/gtk/libnotify/timeout", 3000);
+	accounts[2].available = FALSE;
+
+	/* account 2 has just signed on, its buddy list flood is throttled */
+	event_connection_throttle (&connections[2], NULL);
+
+	for (i = 0; i < SOAK_EVENTS; i++) {
+		run_event (rand_next () % EV_COUNT);
+
+		if (i % SOAK_EXPIRE_EVERY == SOAK_EXPIRE_EVERY - 1) {
+			/* close the presence bursts, but keep account 2 throttled */
+			guint j;
+
+			for (j = 0; j < G_N_ELEMENTS (timers); j++)
+				if (timers[j].tag && timers[j].function == presence_burst_cb)
+					if (!presence_burst_cb (timers[j].data))
+						timers[j].tag = 0;
+
+			popups_expire ();
+		}
+
+		if (i == SOAK_WARMUP) {
+			warm_live = live;
+			warm_rss = rss_bytes ();
+		} else if (i > SOAK_WARMUP && i % SOAK_SAMPLE_EVERY == 0) {
+			rss = rss_bytes ();
+			peak_rss = MAX (peak_rss, rss);
+		}
+	}
+
+	timers_fire ();
+	popups_expire ();
+
+	end_live = live;
+	end_rss = rss_bytes ();
+	peak_rss = MAX (peak_rss, end_rss);
+
+	for (i = 0; i < EV_COUNT; i++) {
+		printf ("%-28s %8lu events", event_names[i], event_count[i]);
+		if (i != EV_IM && i != EV_CHAT_MENTION && i != EV_SIGNON)
+			printf (", %lu allocations", filtered_allocs[i]);
+		printf ("\n");
+	}
+	printf ("delivered %lu events, %.2f allocations each\n",
+			delivered, delivered ? (double)delivered_allocs / delivered : 0.0);
+	printf ("duplicates suppressed: %u\n", dedup_suppressed);
+	printf ("live allocations: %ld after warmup, %ld at the end\n", warm_live, end_live);
+	printf ("resident set: %ld kB after warmup, %ld kB at most, %ld kB at the end\n",
+			warm_rss / 1024, peak_rss / 1024, end_rss / 1024);
+
+	for (i = 0; i < EV_COUNT; i++) {
+		if (filtered_allocs[i]) {
+			fprintf (stderr, "soak: filtered %s events allocated\n", event_names[i]);
+			failed = TRUE;
+		}
+	}
+
+	/* a popup costs its NotifyNotification and nothing else */
+	if (delivered_allocs > delivered) {
+		fprintf (stderr, "soak: delivered events allocated %.2f times each\n",
+				 (double)delivered_allocs / delivered);
+		failed = TRUE;
+	}
+
+	/* plain ims repeating a popup that is still up fold as well */
+	if (dedup_suppressed < event_count[EV_IM_DUPLICATE]) {
+		fprintf (stderr, "soak: %lu duplicates sent, %u suppressed\n",
+				 event_count[EV_IM_DUPLICATE], dedup_suppressed);
+		failed = TRUE;
+	}
+
+	if (end_live > warm_live + SOAK_LIVE_SLACK) {
+		fprintf (stderr, "soak: live allocations grew from %ld to %ld\n", warm_live, end_live);
+		failed = TRUE;
+	}
+
+	if (peak_rss > warm_rss + SOAK_RSS_SLACK) {
+		fprintf (stderr, "soak: resident set grew from %ld to %ld bytes\n", warm_rss, peak_rss);
+		failed = TRUE;
+	}
+
+	/* one person signing on through two accounts is one popup, filed
+	 * under their contact like any other */
+	shown_before = popups_shown;
+	notify_buddy_signon_cb (&buddies[1], NULL);
+	notify_buddy_signon_cb (&buddies[1 + N_CONTACTS], NULL);
+	timers_fire ();
+	if (popups_shown != shown_before + 1 ||
+		!g_hash_table_lookup (buddy_hash, buddies[1].contact)) {
+		fprintf (stderr, "soak: signon through two accounts not shown as one contact\n");
+		failed = TRUE;
+	}
+	popups_expire ();
+
+	/* the history survived a million appends and still reads back */
+	action.plugin = &plugin;
+	history_show_cb (&action);
+	if (history_dialogs != 1) {
+		fprintf (stderr, "soak: history dialog not shown\n");
+		failed = TRUE;
+	}
+
+	plugin_unload (&plugin);
+
+	unlink (history_path);
+	rmdir (user_dir);
+	g_free (history_path);
+	g_free (user_dir);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1 @@
+#include "purple-stubs.h"
@@ -0,0 +1,281 @@
+/*
+ * Pidgin-libnotify - Provides a libnotify interface for Pidgin
+ * Copyright (C) 2005-2007 Duarte Henriques
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* Just enough of the libpurple, pidgin, gobject, gdk-pixbuf and libnotify
+ * API to build pidgin-libnotify.c against plain glib, so soak.c can drive
+ * its handlers directly.  The functions are implemented in soak.c. */
+
+#ifndef PURPLE_STUBS_H
+#define PURPLE_STUBS_H
+
+#include <glib.h>
+#include <time.h>
+
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#else
+#define bindtextdomain(Domain, Directory) ((void) 0)
+#define bind_textdomain_codeset(Domain, Codeset) ((void) 0)
+#endif
+
+/* gobject */
+typedef void (*GCallback) (void);
+
+#define G_CALLBACK(f) ((GCallback)(f))
+#define G_OBJECT(o) ((gpointer)(o))
+
+gpointer g_object_ref (gpointer object);
+void g_object_unref (gpointer object);
+gpointer g_object_get_data (gpointer object, const gchar *key);
+void g_object_set_data (gpointer object, const gchar *key, gpointer data);
+gulong g_signal_connect (gpointer instance, const gchar *signal,
+						 GCallback handler, gpointer data);
+
+/* timers are fired by the test, not by a main loop */
+#define g_timeout_add soak_timeout_add
+#define g_source_remove soak_source_remove
+
+guint soak_timeout_add (guint interval, GSourceFunc function, gpointer data);
+gboolean soak_source_remove (guint tag);
+
+/* gdk-pixbuf */
+typedef struct _GdkPixbuf GdkPixbuf;
+typedef struct _GdkPixbufLoader GdkPixbufLoader;
+
+GdkPixbufLoader *gdk_pixbuf_loader_new (void);
+void gdk_pixbuf_loader_set_size (GdkPixbufLoader *loader, int width, int height);
+gboolean gdk_pixbuf_loader_write (GdkPixbufLoader *loader, const guchar *buf,
+								  gsize count, GError **error);
+gboolean gdk_pixbuf_loader_close (GdkPixbufLoader *loader, GError **error);
+GdkPixbuf *gdk_pixbuf_loader_get_pixbuf (GdkPixbufLoader *loader);
+
+/* libpurple */
+#define PURPLE_PLUGIN_MAGIC 13
+#define PURPLE_MAJOR_VERSION 2
+#define PURPLE_MINOR_VERSION 0
+#define PURPLE_PLUGIN_STANDARD 1
+#define PURPLE_PRIORITY_DEFAULT 0
+
+#define PURPLE_CALLBACK(func) ((gpointer)(func))
+
+typedef enum {
+	PURPLE_CONV_TYPE_IM = 1,
+	PURPLE_CONV_TYPE_CHAT,
+	PURPLE_CONV_TYPE_ANY = 5
+} PurpleConversationType;
+
+typedef struct _PurpleAccount PurpleAccount;
+typedef struct _PurpleConnection PurpleConnection;
+typedef struct _PurpleContact PurpleContact;
+typedef struct _PurpleStatus PurpleStatus;
+typedef struct _PurpleBuddyIcon PurpleBuddyIcon;
+typedef struct _PurpleConversation PurpleConversation;
+typedef struct _PurpleConvChat PurpleConvChat;
+typedef struct _PurplePlugin PurplePlugin;
+typedef struct _PurplePluginPref PurplePluginPref;
+typedef struct _PurplePluginPrefFrame PurplePluginPrefFrame;
+
+struct _PurpleAccount {
+	const gchar *username;
+	PurpleConnection *gc;
+	gboolean available;
+};
+
+struct _PurpleConnection {
+	PurpleAccount *account;
+};
+
+typedef struct {
+	gchar *name;
+	gchar *alias;
+	gchar *server_alias;
+	PurpleAccount *account;
+
+	/* not in libpurple, used by the stubs */
+	PurpleContact *contact;
+	gboolean blocked;
+} PurpleBuddy;
+
+typedef struct {
+	gboolean (*has_focus) (PurpleConversation *conv);
+	void (*present) (PurpleConversation *conv);
+} PurpleConversationUiOps;
+
+struct _PurpleConversation {
+	PurpleConversationUiOps *ui_ops;
+	PurpleAccount *account;
+
+	/* not in libpurple, used by the stubs */
+	const gchar *name;
+	const gchar *nick;
+	gboolean open;
+	gboolean focus;
+};
+
+#define PURPLE_CONV_CHAT(conv) ((PurpleConvChat *)(conv))
+
+struct _PurplePlugin {
+	gpointer info;
+};
+
+typedef struct {
+	PurplePlugin *plugin;
+} PurplePluginAction;
+
+typedef struct {
+	PurplePluginPrefFrame *(*get_plugin_pref_frame) (PurplePlugin *plugin);
+	int page_num;
+	PurplePluginPrefFrame *frame;
+} PurplePluginUiInfo;
+
+typedef struct {
+	unsigned int magic;
+	unsigned int major_version;
+	unsigned int minor_version;
+	int type;
+	char *ui_requirement;
+	unsigned long flags;
+	GList *dependencies;
+	int priority;
+
+	char *id;
+	char *name;
+	char *version;
+	char *summary;
+	char *description;
+	char *author;
+	char *homepage;
+
+	gboolean (*load) (PurplePlugin *plugin);
+	gboolean (*unload) (PurplePlugin *plugin);
+	void (*destroy) (PurplePlugin *plugin);
+
+	gpointer ui_info;
+	gpointer extra_info;
+	PurplePluginUiInfo *prefs_info;
+	GList *(*actions) (PurplePlugin *plugin, gpointer context);
+} PurplePluginInfo;
+
+#define PURPLE_INIT_PLUGIN(pluginname, initfunc, plugininfo) \
+	gboolean purple_init_plugin (PurplePlugin *plugin); \
+	gboolean purple_init_plugin (PurplePlugin *plugin) { \
+		plugin->info = &(plugininfo); \
+		initfunc ((plugin)); \
+		return TRUE; \
+	}
+
+PurplePluginPrefFrame *purple_plugin_pref_frame_new (void);
+void purple_plugin_pref_frame_add (PurplePluginPrefFrame *frame, PurplePluginPref *pref);
+PurplePluginPref *purple_plugin_pref_new_with_name_and_label (const char *name, const char *label);
+void purple_plugin_pref_set_bounds (PurplePluginPref *pref, int min, int max);
+PurplePluginAction *purple_plugin_action_new (const char *label,
+											  void (*callback) (PurplePluginAction *));
+
+void purple_prefs_add_none (const char *name);
+void purple_prefs_add_bool (const char *name, gboolean value);
+void purple_prefs_add_int (const char *name, int value);
+gboolean purple_prefs_get_bool (const char *name);
+int purple_prefs_get_int (const char *name);
+void purple_prefs_set_bool (const char *name, gboolean value);
+void purple_prefs_set_int (const char *name, int value);
+
+void purple_debug_info (const char *category, const char *format, ...) G_GNUC_PRINTF (2, 3);
+void purple_debug_warning (const char *category, const char *format, ...) G_GNUC_PRINTF (2, 3);
+void purple_debug_error (const char *category, const char *format, ...) G_GNUC_PRINTF (2, 3);
+
+void *purple_notify_info (void *handle, const char *title,
+						  const char *primary, const char *secondary);
+void *purple_notify_formatted (void *handle, const char *title, const char *primary,
+							   const char *secondary, const char *text,
+							   GCallback cb, gpointer user_data);
+
+PurpleConnection *purple_account_get_connection (const PurpleAccount *account);
+gboolean purple_account_is_connected (const PurpleAccount *account);
+const char *purple_account_get_username (const PurpleAccount *account);
+PurpleStatus *purple_account_get_active_status (const PurpleAccount *account);
+gboolean purple_status_is_online (const PurpleStatus *status);
+gboolean purple_status_is_available (const PurpleStatus *status);
+PurpleAccount *purple_connection_get_account (const PurpleConnection *gc);
+gboolean purple_privacy_check (PurpleAccount *account, const char *who);
+
+PurpleBuddy *purple_find_buddy (PurpleAccount *account, const char *name);
+PurpleContact *purple_buddy_get_contact (PurpleBuddy *buddy);
+PurpleAccount *purple_buddy_get_account (const PurpleBuddy *buddy);
+PurpleBuddyIcon *purple_buddy_get_icon (const PurpleBuddy *buddy);
+gconstpointer purple_buddy_icon_get_data (const PurpleBuddyIcon *icon, size_t *len);
+
+PurpleConversation *purple_find_conversation_with_account (PurpleConversationType type,
+														   const char *name,
+														   const PurpleAccount *account);
+PurpleConversation *purple_conversation_new (PurpleConversationType type,
+											 PurpleAccount *account, const char *name);
+const char *purple_conversation_get_name (const PurpleConversation *conv);
+gboolean purple_conversation_has_focus (PurpleConversation *conv);
+const char *purple_conv_chat_get_nick (PurpleConvChat *chat);
+
+char *purple_markup_strip_html (const char *str);
+const char *purple_date_format_full (const struct tm *tm);
+const char *purple_user_dir (void);
+
+void *purple_conversations_get_handle (void);
+void *purple_blist_get_handle (void);
+void *purple_connections_get_handle (void);
+gulong purple_signal_connect (void *instance, const char *signal, void *handle,
+							  gpointer func, void *data);
+void purple_signal_disconnect (void *instance, const char *signal, void *handle,
+							   gpointer func);
+
+/* pidgin */
+GdkPixbuf *pidgin_create_prpl_icon (PurpleAccount *account, int size);
+
+/* libnotify */
+typedef struct _NotifyNotification NotifyNotification;
+
+typedef enum {
+	NOTIFY_URGENCY_LOW,
+	NOTIFY_URGENCY_NORMAL,
+	NOTIFY_URGENCY_CRITICAL
+} NotifyUrgency;
+
+typedef void (*NotifyActionCallback) (NotifyNotification *notification,
+									  char *action, gpointer user_data);
+
+gboolean notify_init (const char *app_name);
+void notify_uninit (void);
+gboolean notify_is_initted (void);
+
+#ifdef LIBNOTIFY_07
+NotifyNotification *notify_notification_new (const char *summary, const char *body,
+											 const char *icon);
+#else
+NotifyNotification *notify_notification_new (const char *summary, const char *body,
+											 const char *icon, gpointer attach);
+#endif
+gboolean notify_notification_update (NotifyNotification *notification, const char *summary,
+									 const char *body, const char *icon);
+gboolean notify_notification_show (NotifyNotification *notification, GError **error);
+gboolean notify_notification_close (NotifyNotification *notification, GError **error);
+void notify_notification_set_timeout (NotifyNotification *notification, gint timeout);
+void notify_notification_set_urgency (NotifyNotification *notification, NotifyUrgency urgency);
+void notify_notification_set_icon_from_pixbuf (NotifyNotification *notification, GdkPixbuf *icon);
+void notify_notification_add_action (NotifyNotification *notification, const char *action,
+									 const char *label, NotifyActionCallback callback,
+									 gpointer user_data, GFreeFunc free_func);
+
+#endif /* PURPLE_STUBS_H */